@@ -25,6 +25,8 @@ extern "C" {
 #define HISTORY_SIZE MAX_SNAKE_LENGTH*CUBE_SIZE //max index in MoveSnake method
 #define SNAKE_EXTEND 5 //how much snakes extends/shorten if it eats a dot, should be lower than SNAKE_LENGTH
 #define HISTORY_UPDATE_INTERVAL 0.003 //in seconds, how often history updates
+#define HISTORY_CHUNK 25 //history entries per arena chunk, HISTORY_SIZE must be its multiple
+#define HISTORY_CHUNKS ((HISTORY_SIZE) / HISTORY_CHUNK)
 
 #define DOT_RADIUS 10 //dot size 
 #define RED_DOT_FREQUENCY 5 // minimum 0, maximum 10000 - lover=less frequent
@@ -37,6 +39,28 @@ extern "C" {
 #define MAX_NAME_LENGTH 20
 #define NUM_BEST_SCORES 3 //number of best scores kept in file
 
+#define RANDOM_SEED 1 //seed of the game random numbers, can not be 0
+#define CHECKPOINT_MAGIC 0x314B4E53 //"SNK1", first bytes of a checkpoint file
+
+#define BENCHMARK_FORKS_ARG "--bench-forks" //runs the fork benchmark instead of the game
+#define BENCHMARK_RENDER_ARG "--bench-render" //runs the drawing benchmark instead of the game
+#define BENCHMARK_FORKS 1000000
+#define BENCHMARK_BATCH 64 //forks kept alive at once
+#define BENCHMARK_ROLLOUTS 10000
+#define BENCHMARK_ROLLOUT_STEPS 100
+#define BENCHMARK_DELTA (1.0 / 60) //simulated frame time in seconds
+#define BENCHMARK_CHECKPOINT_FILE "bench_checkpoint.bin"
+#define BENCHMARK_RENDER_WIDTH 3840
+#define BENCHMARK_RENDER_HEIGHT 2160
+#define BENCHMARK_RENDER_FRAMES 100
+
+#define RENDER_THREADS 1 //threads drawing the game, 0 - one per CPU core, 1 - serial drawing; threads pay off only on large screens, see --bench-render
+#define MAX_RENDER_THREADS 16
+#define RENDER_BANDS_PER_THREAD 4 //horizontal bands per drawing thread, more bands balance the load better
+#define MAX_RENDER_BANDS (MAX_RENDER_THREADS * RENDER_BANDS_PER_THREAD)
+#define MAX_DRAW_COMMANDS 2048 //draw commands recorded before they are rendered, enough for the tiled benchmark frame
+
+struct Rasterizer;
 
 struct SDLStruct {
     SDL_Window* window;
@@ -48,17 +72,38 @@ struct SDLStruct {
     SDL_Surface* body2;
     SDL_Surface* head;
     SDL_Surface* tail;
+    Rasterizer* raster;
 };
 
 struct GameParameters {
     bool quit;
 };
 
+// Full chunks of snake history are never modified, so copies of a snake share them.
+struct HistoryChunk {
+    double x[HISTORY_CHUNK];
+    double y[HISTORY_CHUNK];
+    Uint32 stamp; //unique in the arena, tells a reused index from the chunk a snake was given
+};
+
+// An arena is used by one thread at a time, parallel searches need an arena per thread.
+struct HistoryArena {
+    HistoryChunk* chunks;
+    int count;
+    int capacity;
+    Uint32 nextStamp;
+};
+
 struct Snake {
     double bodyX[MAX_SNAKE_LENGTH];
     double bodyY[MAX_SNAKE_LENGTH];
-    double historyX[HISTORY_SIZE];
-    double historyY[HISTORY_SIZE];
+    double recentX[HISTORY_CHUNK]; //newest history entries, not yet moved to the arena
+    double recentY[HISTORY_CHUNK];
+    int recentCount;
+    int chunks[HISTORY_CHUNKS]; //arena indexes of older history, ring buffer
+    Uint32 stamps[HISTORY_CHUNKS]; //stamps of those chunks, see ValidHistory
+    int newestChunk; //ring position of the newest chunk
+    HistoryArena* arena;
     int length;
     float speed;
     double velocityX;
@@ -85,6 +130,15 @@ struct GameTime {
     double lastHistoryUpdate;
 };
 
+// Whole game state, a plain copy of it is an independent fork of the game.
+struct GameState {
+    Snake snake;
+    Dot blueDot;
+    Dot redDot;
+    GameTime time;
+    Uint32 rng;
+};
+
 void DrawString(SDL_Surface* screen, int x, int y, const char* text, SDL_Surface* charset) {
     int px, py, c;
     SDL_Rect s, d;
@@ -116,6 +170,7 @@ void DrawSurface(SDL_Surface* screen, SDL_Surface* sprite, int x, int y) {
 }
 
 void DrawPixel(SDL_Surface* surface, int x, int y, Uint32 color) {
+    if (x < 0 || y < 0 || x >= surface->w || y >= surface->h) return;
     int bpp = surface->format->BytesPerPixel;
     Uint8* p = (Uint8*)surface->pixels + y * surface->pitch + x * bpp;
     *(Uint32*)p = color;
@@ -135,32 +190,281 @@ void DrawRectangle(SDL_Surface* screen, int x, int y, int l, int k, Uint32 outli
     DrawLine(screen, x + l - 1, y, k, 0, 1, outlineColor);
     DrawLine(screen, x, y, l, 1, 0, outlineColor);
     DrawLine(screen, x, y + k - 1, l, 1, 0, outlineColor);
-    for (i = y + 1; i < y + k - 1; i++)
+    int top = y + 1 < 0 ? 0 : y + 1; //rows outside the surface are skipped
+    int bottom = y + k - 1 > screen->h ? screen->h : y + k - 1;
+    for (i = top; i < bottom; i++)
         DrawLine(screen, x + 1, i, l - 2, 1, 0, fillColor);
 }
 
-void DrawDot(SDL_Surface* surface, Dot& d, GameTime& time) {
+void DrawCircle(SDL_Surface* surface, int cx, int cy, int radius, Uint32 color) {
+    int top = cy - radius < 0 ? -cy : -radius; //rows outside the surface are skipped
+    int bottom = cy + radius >= surface->h ? surface->h - 1 - cy : radius;
+    for (int y = top; y <= bottom; y++) {
+        for (int x = -radius; x <= radius; x++) {
+            if (x * x + y * y <= radius * radius) { //inside the circle
+                DrawPixel(surface, cx + x, cy + y, color);
+            }
+        }
+    }
+}
+
+int DotRadius(GameTime& time) {
     int t = (((int)time.worldTime) % DOT_RADIUS);
     if (t > (DOT_RADIUS / 2)) {
         t = DOT_RADIUS - t;
     }
-    int radius = DOT_RADIUS / 2 + t;
-    if (d.x != NULL && d.y != NULL) {
-        for (int y = -radius; y <= radius; y++) {
-            for (int x = -radius; x <= radius; x++) {
-                if (x * x + y * y <= radius * radius) { //inside the circle
-                    DrawPixel(surface, d.x + x, d.y + y, d.color);
-                }
-            }
+    return DOT_RADIUS / 2 + t;
+}
+
+
+// Banded rasterizer: draw calls are recorded as commands, binned to the horizontal
+// bands they overlap and rendered band by band by a pool of threads.
+// Every band is drawn by the same Draw* functions as the serial path, clipped to the band.
+
+enum SpriteId { SPRITE_HEAD, SPRITE_BODY, SPRITE_BODY2, SPRITE_TAIL, SPRITE_CHARSET, SPRITE_COUNT };
+
+enum DrawCommandType { DRAW_CLEAR, DRAW_SPRITE, DRAW_STRING, DRAW_CIRCLE, DRAW_RECTANGLE };
+
+struct DrawCommand {
+    int type;
+    int x;
+    int y;
+    int w; //rectangle width or circle radius
+    int h; //rectangle height
+    int sprite;
+    Uint32 color;
+    Uint32 fillColor;
+    char text[128];
+};
+
+struct RenderWorker {
+    SDL_Thread* thread; //NULL for the main thread
+    SDL_Surface* views[MAX_RENDER_BANDS]; //windows into the screen rows of each band, per worker because a blit map keeps a reference to its destination
+    SDL_Surface* sprites[SPRITE_COUNT]; //private copies, so blits on different threads do not share blit maps
+    Rasterizer* raster;
+};
+
+struct Rasterizer {
+    SDL_Surface* screen;
+    bool direct; //one thread: Queue* functions draw straight on the screen, nothing is recorded
+    int bandCount;
+    DrawCommand commands[MAX_DRAW_COMMANDS];
+    int commandCount;
+    int bandCommands[MAX_RENDER_BANDS][MAX_DRAW_COMMANDS]; //indexes of commands overlapping each band, in drawing order
+    int bandCommandCount[MAX_RENDER_BANDS];
+    RenderWorker workers[MAX_RENDER_THREADS]; //workers[0] is the main thread
+    int workerCount;
+    SDL_atomic_t nextBand;
+    SDL_sem* start;
+    SDL_sem* done;
+    bool quit;
+};
+
+// bands differ in height by at most one row, so their count can be any multiple of the threads
+int BandTop(Rasterizer& r, int band) {
+    return band * r.screen->h / r.bandCount;
+}
+
+int BandOfRow(Rasterizer& r, int y) {
+    return ((y + 1) * r.bandCount - 1) / r.screen->h;
+}
+
+void RenderBand(Rasterizer& r, RenderWorker& w, int band) {
+    int top = BandTop(r, band);
+    SDL_Surface* view = w.views[band];
+
+    for (int i = 0; i < r.bandCommandCount[band]; i++) {
+        DrawCommand& c = r.commands[r.bandCommands[band][i]];
+        switch (c.type) {
+        case DRAW_CLEAR:
+            SDL_FillRect(view, NULL, c.color);
+            break;
+        case DRAW_SPRITE:
+            DrawSurface(view, w.sprites[c.sprite], c.x, c.y - top);
+            break;
+        case DRAW_STRING:
+            DrawString(view, c.x, c.y - top, c.text, w.sprites[SPRITE_CHARSET]);
+            break;
+        case DRAW_CIRCLE:
+            DrawCircle(view, c.x, c.y - top, c.w, c.color);
+            break;
+        case DRAW_RECTANGLE:
+            DrawRectangle(view, c.x, c.y - top, c.w, c.h, c.color, c.fillColor);
+            break;
         }
     }
 }
 
+void RenderBands(Rasterizer& r, RenderWorker& w) {
+    int band;
+    while ((band = SDL_AtomicAdd(&r.nextBand, 1)) < r.bandCount) {
+        RenderBand(r, w, band);
+    }
+}
+
+int RenderThread(void* data) {
+    RenderWorker& w = *(RenderWorker*)data;
+    Rasterizer& r = *w.raster;
+    while (true) {
+        SDL_SemWait(r.start);
+        if (r.quit) break;
+        RenderBands(r, w);
+        SDL_SemPost(r.done);
+    }
+    return 0;
+}
+
+void FlushDrawCommands(Rasterizer& r) {
+    if (r.commandCount == 0) return;
+    SDL_AtomicSet(&r.nextBand, 0);
+    for (int i = 1; i < r.workerCount; i++) SDL_SemPost(r.start);
+    RenderBands(r, r.workers[0]);
+    for (int i = 1; i < r.workerCount; i++) SDL_SemWait(r.done);
+
+    r.commandCount = 0;
+    for (int i = 0; i < r.bandCount; i++) r.bandCommandCount[i] = 0;
+}
+
+// top and bottom are screen rows covered by the command, bottom excluded
+DrawCommand& AddDrawCommand(Rasterizer& r, int type, int top, int bottom) {
+    if (r.commandCount == MAX_DRAW_COMMANDS) FlushDrawCommands(r);
+    if (top < 0) top = 0;
+    if (bottom > r.screen->h) bottom = r.screen->h;
+    if (top < bottom) {
+        for (int band = BandOfRow(r, top); band <= BandOfRow(r, bottom - 1); band++) {
+            r.bandCommands[band][r.bandCommandCount[band]++] = r.commandCount;
+        }
+    }
+    DrawCommand& c = r.commands[r.commandCount++];
+    c.type = type;
+    return c;
+}
+
+void QueueClear(Rasterizer& r, Uint32 color) {
+    if (r.direct) {
+        SDL_FillRect(r.screen, NULL, color);
+        return;
+    }
+    DrawCommand& c = AddDrawCommand(r, DRAW_CLEAR, 0, r.screen->h);
+    c.color = color;
+}
+
+void QueueSurface(Rasterizer& r, int sprite, int x, int y) {
+    if (r.direct) {
+        DrawSurface(r.screen, r.workers[0].sprites[sprite], x, y);
+        return;
+    }
+    int h = r.workers[0].sprites[sprite]->h;
+    DrawCommand& c = AddDrawCommand(r, DRAW_SPRITE, y - h / 2, y - h / 2 + h);
+    c.sprite = sprite;
+    c.x = x;
+    c.y = y;
+}
+
+void QueueString(Rasterizer& r, int x, int y, const char* text) {
+    if (r.direct) {
+        DrawString(r.screen, x, y, text, r.workers[0].sprites[SPRITE_CHARSET]);
+        return;
+    }
+    DrawCommand& c = AddDrawCommand(r, DRAW_STRING, y, y + 8);
+    c.x = x;
+    c.y = y;
+    strncpy(c.text, text, sizeof(c.text) - 1);
+    c.text[sizeof(c.text) - 1] = '\0';
+}
+
+void QueueCircle(Rasterizer& r, int cx, int cy, int radius, Uint32 color) {
+    if (r.direct) {
+        DrawCircle(r.screen, cx, cy, radius, color);
+        return;
+    }
+    DrawCommand& c = AddDrawCommand(r, DRAW_CIRCLE, cy - radius, cy + radius + 1);
+    c.x = cx;
+    c.y = cy;
+    c.w = radius;
+    c.color = color;
+}
+
+void QueueRectangle(Rasterizer& r, int x, int y, int l, int k, Uint32 outlineColor, Uint32 fillColor) {
+    if (r.direct) {
+        DrawRectangle(r.screen, x, y, l, k, outlineColor, fillColor);
+        return;
+    }
+    DrawCommand& c = AddDrawCommand(r, DRAW_RECTANGLE, y, y + k);
+    c.x = x;
+    c.y = y;
+    c.w = l;
+    c.h = k;
+    c.color = outlineColor;
+    c.fillColor = fillColor;
+}
+
+// threads: 0 - one per CPU core, 1 - direct drawing without bands
+bool InitRasterizer(SDLStruct& sdl, int threads) {
+    Rasterizer* r = (Rasterizer*)calloc(1, sizeof(Rasterizer));
+    sdl.raster = r;
+    if (r == NULL) return 1;
+
+    r->screen = sdl.screen;
+    r->workerCount = threads > 0 ? threads : SDL_GetCPUCount();
+    if (r->workerCount < 1) r->workerCount = 1;
+    if (r->workerCount > MAX_RENDER_THREADS) r->workerCount = MAX_RENDER_THREADS;
+    r->direct = r->workerCount == 1;
+    r->bandCount = r->workerCount * RENDER_BANDS_PER_THREAD;
+
+    r->start = SDL_CreateSemaphore(0);
+    r->done = SDL_CreateSemaphore(0);
+    if (r->start == NULL || r->done == NULL) return 1;
+
+    SDL_Surface* sprites[SPRITE_COUNT] = { sdl.head, sdl.body, sdl.body2, sdl.tail, sdl.charset };
+    SDL_PixelFormat* f = sdl.screen->format;
+    for (int i = 0; i < r->workerCount; i++) {
+        RenderWorker& w = r->workers[i];
+        w.raster = r;
+        for (int band = 0; band < r->bandCount && !r->direct; band++) {
+            int top = BandTop(*r, band);
+            Uint8* pixels = (Uint8*)sdl.screen->pixels + top * sdl.screen->pitch;
+            w.views[band] = SDL_CreateRGBSurfaceFrom(pixels, sdl.screen->w, BandTop(*r, band + 1) - top, f->BitsPerPixel, sdl.screen->pitch, f->Rmask, f->Gmask, f->Bmask, f->Amask);
+            if (w.views[band] == NULL) return 1;
+        }
+        for (int j = 0; j < SPRITE_COUNT; j++) {
+            w.sprites[j] = (i == 0) ? sprites[j] : SDL_DuplicateSurface(sprites[j]);
+            if (w.sprites[j] == NULL) return 1;
+        }
+        if (i > 0) {
+            w.thread = SDL_CreateThread(RenderThread, "render", &w);
+            if (w.thread == NULL) return 1;
+        }
+    }
+    return 0;
+}
+
+void FreeRasterizer(SDLStruct& sdl) {
+    Rasterizer* r = sdl.raster;
+    if (r == NULL) return;
+
+    r->quit = true;
+    for (int i = 1; i < MAX_RENDER_THREADS; i++) {
+        if (r->workers[i].thread != NULL) SDL_SemPost(r->start);
+    }
+    for (int i = 0; i < MAX_RENDER_THREADS; i++) {
+        RenderWorker& w = r->workers[i];
+        if (w.thread != NULL) SDL_WaitThread(w.thread, NULL);
+        for (int band = 0; band < MAX_RENDER_BANDS; band++) SDL_FreeSurface(w.views[band]);
+        for (int j = 0; j < SPRITE_COUNT && i > 0; j++) SDL_FreeSurface(w.sprites[j]);
+    }
+    if (r->start != NULL) SDL_DestroySemaphore(r->start);
+    if (r->done != NULL) SDL_DestroySemaphore(r->done);
+    free(r);
+    sdl.raster = NULL;
+}
+
 #ifdef __cplusplus
 extern "C"
 #endif
 
 bool InitSDL(SDLStruct& sdl) {
+    sdl.raster = NULL;
     if (SDL_Init(SDL_INIT_EVERYTHING) != 0) {
         printf("SDL_Init error: %s\n", SDL_GetError());
         return 1;
@@ -212,10 +516,27 @@ bool InitSDL(SDLStruct& sdl) {
         return 1;
     }
 
+    if (InitRasterizer(sdl, RENDER_THREADS)) {
+        printf("InitRasterizer error: %s\n", SDL_GetError());
+        FreeRasterizer(sdl);
+        SDL_FreeSurface(sdl.charset);
+        SDL_FreeSurface(sdl.screen);
+        SDL_FreeSurface(sdl.body);
+        SDL_FreeSurface(sdl.body2);
+        SDL_FreeSurface(sdl.tail);
+        SDL_FreeSurface(sdl.head);
+        SDL_DestroyTexture(sdl.scrtex);
+        SDL_DestroyWindow(sdl.window);
+        SDL_DestroyRenderer(sdl.renderer);
+        SDL_Quit();
+        return 1;
+    }
+
     return 0;
 }
 
 void CleanSDL(SDLStruct& sdl) {
+    FreeRasterizer(sdl);
     SDL_FreeSurface(sdl.charset);
     SDL_FreeSurface(sdl.screen);
     SDL_FreeSurface(sdl.body);
@@ -228,7 +549,140 @@ void CleanSDL(SDLStruct& sdl) {
     SDL_Quit();
 }
 
-void InitGame(bool* quit, Snake& s, Dot& b, Dot& r, SDLStruct sdl) {
+int Random(Uint32& rng) { //xorshift, replaces rand() so the generator is part of the game state
+    rng ^= rng << 13;
+    rng ^= rng >> 17;
+    rng ^= rng << 5;
+    return (int)(rng >> 1);
+}
+
+int AllocHistoryChunk(HistoryArena& a, double* x, double* y) {
+    if (a.count == a.capacity) {
+        int capacity = a.capacity ? a.capacity * 2 : 1024;
+        HistoryChunk* chunks = (HistoryChunk*)realloc(a.chunks, capacity * sizeof(HistoryChunk));
+        if (chunks == NULL) {
+            printf("AllocHistoryChunk error: out of memory\n");
+            exit(1);
+        }
+        a.chunks = chunks;
+        a.capacity = capacity;
+    }
+    HistoryChunk& c = a.chunks[a.count];
+    memcpy(c.x, x, sizeof(c.x));
+    memcpy(c.y, y, sizeof(c.y));
+    c.stamp = a.nextStamp++;
+    return a.count++;
+}
+
+void SetHistoryChunk(Snake& s, int ring, int chunk) {
+    s.chunks[ring] = chunk;
+    s.stamps[ring] = s.arena->chunks[chunk].stamp;
+}
+
+// false when the arena was compacted or released under the snake and its history is gone
+bool ValidHistory(Snake& s) {
+    for (int i = 0; i < HISTORY_CHUNKS; i++) {
+        if (s.chunks[i] >= s.arena->count || s.arena->chunks[s.chunks[i]].stamp != s.stamps[i]) return false;
+    }
+    return true;
+}
+
+// moves the history of s to its own chunks in the arena to, s no longer depends on its old arena
+void CopyHistory(Snake& s, HistoryArena& to) {
+    HistoryArena& from = *s.arena;
+    if (&from == &to) return;
+    for (int i = 0; i < HISTORY_CHUNKS; i++) {
+        int chunk = AllocHistoryChunk(to, from.chunks[s.chunks[i]].x, from.chunks[s.chunks[i]].y);
+        s.chunks[i] = chunk;
+        s.stamps[i] = to.chunks[chunk].stamp;
+    }
+    s.arena = &to;
+}
+
+// keeps only the chunks used by s, every other snake using the arena becomes invalid
+void CompactHistory(HistoryArena& a, Snake& s) {
+    HistoryArena compact = { NULL, 0, 0, a.nextStamp };
+    CopyHistory(s, compact);
+    free(a.chunks);
+    a.chunks = compact.chunks;
+    a.count = compact.count;
+    a.capacity = compact.capacity;
+    a.nextStamp = compact.nextStamp;
+    s.arena = &a;
+}
+
+// chunks allocated after the mark are dropped by ReleaseHistory, together with the states using them,
+// e.g. mark before a search, fork and play out, release after the move is chosen
+int MarkHistory(HistoryArena& a) {
+    return a.count;
+}
+
+void ReleaseHistory(HistoryArena& a, int mark) {
+    a.count = mark;
+}
+
+void FreeHistoryArena(HistoryArena& a) {
+    free(a.chunks);
+    a.chunks = NULL;
+    a.count = 0;
+    a.capacity = 0;
+}
+
+void ResetHistory(Snake& s, HistoryArena& arena, double x, double y) {
+    double chunkX[HISTORY_CHUNK];
+    double chunkY[HISTORY_CHUNK];
+    for (int i = 0; i < HISTORY_CHUNK; i++) {
+        chunkX[i] = x;
+        chunkY[i] = y;
+    }
+    int chunk = AllocHistoryChunk(arena, chunkX, chunkY);
+    s.arena = &arena;
+    for (int i = 0; i < HISTORY_CHUNKS; i++) {
+        SetHistoryChunk(s, i, chunk);
+    }
+    s.recentCount = 0;
+    s.newestChunk = 0;
+}
+
+void PushHistory(Snake& s, double x, double y) {
+    s.recentX[s.recentCount] = x;
+    s.recentY[s.recentCount] = y;
+    s.recentCount++;
+    if (s.recentCount == HISTORY_CHUNK) {
+        s.newestChunk = (s.newestChunk + 1) % HISTORY_CHUNKS;
+        SetHistoryChunk(s, s.newestChunk, AllocHistoryChunk(*s.arena, s.recentX, s.recentY));
+        s.recentCount = 0;
+    }
+}
+
+// i-th position of the head back in time, 0 is the newest
+void GetHistory(Snake& s, int i, double& x, double& y) {
+    if (i < s.recentCount) {
+        x = s.recentX[s.recentCount - 1 - i];
+        y = s.recentY[s.recentCount - 1 - i];
+        return;
+    }
+    i -= s.recentCount;
+    HistoryChunk& c = s.arena->chunks[s.chunks[(s.newestChunk - i / HISTORY_CHUNK + HISTORY_CHUNKS) % HISTORY_CHUNKS]];
+    x = c.x[HISTORY_CHUNK - 1 - i % HISTORY_CHUNK];
+    y = c.y[HISTORY_CHUNK - 1 - i % HISTORY_CHUNK];
+}
+
+bool HistoryOverlaps(Snake& s, int x, int y) {
+    double hx, hy;
+    for (int i = 0; i < HISTORY_SIZE; i++) {
+        GetHistory(s, i, hx, hy);
+        if (fabs(x - hx) < CUBE_SIZE && fabs(y - hy) < CUBE_SIZE) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void InitGame(bool* quit, GameState& g, HistoryArena& arena, SDL_PixelFormat* format) {
+    Snake& s = g.snake;
+    Dot& b = g.blueDot;
+    Dot& r = g.redDot;
     *quit = false;
     s.length = SNAKE_LENGTH;
     s.velocityX = 0;
@@ -239,26 +693,26 @@ void InitGame(bool* quit, Snake& s, Dot& b, Dot& r, SDLStruct sdl) {
     s.bodyX[0] = SCREEN_WIDTH / 2;
     s.bodyY[0] = SCREEN_HEIGHT / 2;
 
-    b.x = (rand() % ((SCREEN_WIDTH / CUBE_SIZE) - 2) + 1) * CUBE_SIZE;
-    b.y = (rand() % ((GAME_HEIGHT / CUBE_SIZE) - 2) + 1) * CUBE_SIZE;
-    b.color = SDL_MapRGB(sdl.screen->format, 0, 0, 255);
+    b.x = (Random(g.rng) % ((SCREEN_WIDTH / CUBE_SIZE) - 2) + 1) * CUBE_SIZE;
+    b.y = (Random(g.rng) % ((GAME_HEIGHT / CUBE_SIZE) - 2) + 1) * CUBE_SIZE;
+    b.color = SDL_MapRGB(format, 0, 0, 255);
+    b.spawnTime = 0;
+    b.duration = 0;
+    b.visible = true;
 
     r.x = 0;
     r.y = 0;
-    r.color = SDL_MapRGB(sdl.screen->format, 255, 0, 0);
+    r.color = SDL_MapRGB(format, 255, 0, 0);
     r.spawnTime = 0;
     r.duration = 10.0;
     r.visible = false;
 
-    for (int i = 1; i < s.length; i++) {
+    for (int i = 1; i < MAX_SNAKE_LENGTH; i++) {
         s.bodyX[i] = s.bodyX[i - 1];
         s.bodyY[i] = s.bodyY[i - 1];
     }
 
-    for (int i = 0; i < HISTORY_SIZE; i++) {
-        s.historyX[i] = s.bodyX[0];
-        s.historyY[i] = s.bodyY[0];
-    }
+    ResetHistory(s, arena, s.bodyX[0], s.bodyY[0]);
 }
 
 
@@ -273,31 +727,31 @@ float GetSnakeSpeed(GameTime t, Snake& s) {
 }
 
 
+void TurnSnake(Snake& s, int dx, int dy) { //the snake can not turn back
+    if (dx != 0 && s.velocityX == 0) {
+        s.velocityX = dx;
+        s.velocityY = 0;
+    }
+    else if (dy != 0 && s.velocityY == 0) {
+        s.velocityX = 0;
+        s.velocityY = dy;
+    }
+}
+
+
 bool UserInput(bool* quit, Snake& s, SDL_Event& event) {
     if (event.type == SDL_KEYDOWN) {
         if (event.key.keysym.sym == END_GAME_KEY) *quit = true;
         else if (event.key.keysym.sym == NEW_GAME_KEY) return false;
-        else if (event.key.keysym.sym == SDLK_UP && s.velocityY == 0) {
-            s.velocityX = 0;
-            s.velocityY = -1;
-        }
-        else if (event.key.keysym.sym == SDLK_DOWN && s.velocityY == 0) {
-            s.velocityX = 0;
-            s.velocityY = 1;
-        }
-        else if (event.key.keysym.sym == SDLK_LEFT && s.velocityX == 0) {
-            s.velocityX = -1;
-            s.velocityY = 0;
-        }
-        else if (event.key.keysym.sym == SDLK_RIGHT && s.velocityX == 0) {
-            s.velocityX = 1;
-            s.velocityY = 0;
-        }
+        else if (event.key.keysym.sym == SDLK_UP) TurnSnake(s, 0, -1);
+        else if (event.key.keysym.sym == SDLK_DOWN) TurnSnake(s, 0, 1);
+        else if (event.key.keysym.sym == SDLK_LEFT) TurnSnake(s, -1, 0);
+        else if (event.key.keysym.sym == SDLK_RIGHT) TurnSnake(s, 1, 0);
     }
     return true;
 }
 
-void BlueDotCollision(Snake& s, Dot& b) {
+void BlueDotCollision(Snake& s, Dot& b, Uint32& rng) {
     if (abs((int)s.bodyX[0] - b.x) <= CUBE_SIZE && abs((int)s.bodyY[0] - b.y) <= CUBE_SIZE) {
         s.eaten = s.eaten + POINTS_FOR_A_DOT;
         if (s.length + SNAKE_EXTEND <= MAX_SNAKE_LENGTH) {
@@ -306,24 +760,18 @@ void BlueDotCollision(Snake& s, Dot& b) {
         bool okPos;
         do {
             okPos = true;
-            b.x = (rand() % ((SCREEN_WIDTH / CUBE_SIZE) - 2) + 1) * CUBE_SIZE;
-            b.y = (rand() % ((GAME_HEIGHT / CUBE_SIZE) - 2) + 1) * CUBE_SIZE;
-
-            for (int i = 0; i < HISTORY_SIZE; i++) {
-                if (fabs(b.x - s.historyX[i]) < CUBE_SIZE &&
-                    fabs(b.y - s.historyY[i]) < CUBE_SIZE) {
-                    okPos = 0;
-                    break;
-                }
-            }
+            b.x = (Random(rng) % ((SCREEN_WIDTH / CUBE_SIZE) - 2) + 1) * CUBE_SIZE;
+            b.y = (Random(rng) % ((GAME_HEIGHT / CUBE_SIZE) - 2) + 1) * CUBE_SIZE;
+
+            if (HistoryOverlaps(s, b.x, b.y)) okPos = 0;
         } while (!okPos);
     }
 }
 
-void RedDotCollision(Snake& s, Dot& r, GameTime& t) {
+void RedDotCollision(Snake& s, Dot& r, GameTime& t, Uint32& rng) {
     if (r.visible && fabs(s.bodyX[0] - r.x) <= CUBE_SIZE && fabs(s.bodyY[0] - r.y) <= CUBE_SIZE) {
         s.eaten = s.eaten + POINTS_FOR_A_DOT;
-        if (rand() % 2 && s.length > SNAKE_LENGTH) {
+        if (Random(rng) % 2 && s.length > SNAKE_LENGTH) {
             s.length = s.length - SNAKE_EXTEND;
         }
         else if (s.speed > SNAKE_SPEED && t.snakeTime > SNAKE_SPEED_DOWN) {
@@ -344,12 +792,7 @@ void RedDotCollision(Snake& s, Dot& r, GameTime& t) {
 }
 
 void UpdateHistory(Snake& s, GameTime& time) {
-    for (int i = HISTORY_SIZE - 1; i > 0; i--) {
-        s.historyX[i] = s.historyX[i - 1];
-        s.historyY[i] = s.historyY[i - 1];
-    }
-    s.historyX[0] = s.bodyX[0];
-    s.historyY[0] = s.bodyY[0];
+    PushHistory(s, s.bodyX[0], s.bodyY[0]);
     time.lastHistoryUpdate = time.worldTime;
 }
 
@@ -386,40 +829,52 @@ void MoveSnake(Snake& s, GameTime& time, double delta) {
         if (speed > MAX_SNAKE_SPEED / SNAKE_SPEED) speed = (MAX_SNAKE_SPEED / SNAKE_SPEED);
         int historyIndex = i * CUBE_SIZE / speed;
         if (historyIndex >= HISTORY_SIZE) historyIndex = HISTORY_SIZE - 1;
-        s.bodyX[i] = s.historyX[historyIndex];
-        s.bodyY[i] = s.historyY[historyIndex];
+        GetHistory(s, historyIndex, s.bodyX[i], s.bodyY[i]);
     }
 }
 
 
-void Draw(SDLStruct& sdl, Snake& s, Dot& b, Dot& r, GameTime& time) {
+// queues the game frame with its top left corner at ox, oy
+void QueueGame(Rasterizer& raster, SDL_PixelFormat* format, int ox, int oy, Snake& s, Dot& b, Dot& r, GameTime& time) {
     char text[128];
-    SDL_FillRect(sdl.screen, NULL, SDL_MapRGB(sdl.screen->format, 0x00, 0x00, 0x00));
 
     // Snake
-    DrawSurface(sdl.screen, sdl.head, (int)s.bodyX[0], (int)s.bodyY[0]);
+    QueueSurface(raster, SPRITE_HEAD, ox + (int)s.bodyX[0], oy + (int)s.bodyY[0]);
     for (int i = 1; i < s.length - 1; i++) {
-        if (i % 2) DrawSurface(sdl.screen, sdl.body, (int)s.bodyX[i], (int)s.bodyY[i]);
-        else DrawSurface(sdl.screen, sdl.body2, (int)s.bodyX[i], (int)s.bodyY[i]);
+        if (i % 2) QueueSurface(raster, SPRITE_BODY, ox + (int)s.bodyX[i], oy + (int)s.bodyY[i]);
+        else QueueSurface(raster, SPRITE_BODY2, ox + (int)s.bodyX[i], oy + (int)s.bodyY[i]);
     }
-    DrawSurface(sdl.screen, sdl.tail, (int)s.bodyX[s.length - 1], (int)s.bodyY[s.length - 1]);
+    QueueSurface(raster, SPRITE_TAIL, ox + (int)s.bodyX[s.length - 1], oy + (int)s.bodyY[s.length - 1]);
 
     //blueDot 
-    DrawDot(sdl.screen, b, time);
+    if (b.x != 0 && b.y != 0) QueueCircle(raster, ox + b.x, oy + b.y, DotRadius(time), b.color);
 
     //redDot
-    if (r.visible) DrawDot(sdl.screen, r, time);
+    if (r.visible && r.x != 0 && r.y != 0) QueueCircle(raster, ox + r.x, oy + r.y, DotRadius(time), r.color);
 
     // Updates 
-    DrawRectangle(sdl.screen, 4, GAME_HEIGHT + 4, SCREEN_WIDTH - 8, 36, SDL_MapRGB(sdl.screen->format, 0xFF, 0x00, 0x00), SDL_MapRGB(sdl.screen->format, 0x11, 0x11, 0xCC));
+    QueueRectangle(raster, ox + 4, oy + GAME_HEIGHT + 4, SCREEN_WIDTH - 8, 36, SDL_MapRGB(format, 0xFF, 0x00, 0x00), SDL_MapRGB(format, 0x11, 0x11, 0xCC));
     sprintf(text, "Elapsed time = %.1lfs  %.0lfFPS  Speed: %.1lfx  Length:%d  Points:%d", time.worldTime, time.fps, (s.speed / SNAKE_SPEED), s.length, s.eaten);
-    DrawString(sdl.screen, sdl.screen->w / 2 - strlen(text) * 8 / 2, GAME_HEIGHT + 10, text, sdl.charset);
+    QueueString(raster, ox + SCREEN_WIDTH / 2 - strlen(text) * 8 / 2, oy + GAME_HEIGHT + 10, text);
     sprintf(text, "Esc - exit, N - new game, Arrow keys - move");
-    DrawString(sdl.screen, sdl.screen->w / 2 - strlen(text) * 8 / 2, GAME_HEIGHT + 26, text, sdl.charset);
+    QueueString(raster, ox + SCREEN_WIDTH / 2 - strlen(text) * 8 / 2, oy + GAME_HEIGHT + 26, text);
 
-    DrawRectangle(sdl.screen, 4, GAME_HEIGHT + 46, SCREEN_WIDTH - 8, 18, SDL_MapRGB(sdl.screen->format, 0xFF, 0x00, 0x00), SDL_MapRGB(sdl.screen->format, 0x11, 0x11, 0xCC));
+    QueueRectangle(raster, ox + 4, oy + GAME_HEIGHT + 46, SCREEN_WIDTH - 8, 18, SDL_MapRGB(format, 0xFF, 0x00, 0x00), SDL_MapRGB(format, 0x11, 0x11, 0xCC));
     int count = (int)(time.worldTime - r.spawnTime);
-    if (r.visible) DrawRectangle(sdl.screen, 4, GAME_HEIGHT + 46, count * (SCREEN_WIDTH - 8) / r.duration, 18, SDL_MapRGB(sdl.screen->format, 0xFF, 0x00, 0x00), SDL_MapRGB(sdl.screen->format, 0xFF, 0x00, 0x00));
+    if (r.visible) QueueRectangle(raster, ox + 4, oy + GAME_HEIGHT + 46, count * (SCREEN_WIDTH - 8) / r.duration, 18, SDL_MapRGB(format, 0xFF, 0x00, 0x00), SDL_MapRGB(format, 0xFF, 0x00, 0x00));
+}
+
+
+void RenderGame(SDLStruct& sdl, Snake& s, Dot& b, Dot& r, GameTime& time) {
+    Rasterizer& raster = *sdl.raster;
+    QueueClear(raster, SDL_MapRGB(sdl.screen->format, 0x00, 0x00, 0x00));
+    QueueGame(raster, sdl.screen->format, 0, 0, s, b, r, time);
+    FlushDrawCommands(raster);
+}
+
+
+void Draw(SDLStruct& sdl, Snake& s, Dot& b, Dot& r, GameTime& time) {
+    RenderGame(sdl, s, b, r, time);
     SDL_UpdateTexture(sdl.scrtex, NULL, sdl.screen->pixels, sdl.screen->pitch);
     SDL_RenderCopy(sdl.renderer, sdl.scrtex, NULL, NULL);
     SDL_RenderPresent(sdl.renderer);
@@ -435,22 +890,20 @@ bool Collision(Snake& s) {
     return false;
 }
 
+bool GameLost(Snake& s) {
+    return Collision(s) && s.bodyX[SNAKE_LENGTH - 1] != SCREEN_WIDTH / 2;
+}
+
 
-void SpawnRedDot(Dot& r, Snake& s, GameTime t) {
-    if (!r.visible && (rand() % 10000 <= RED_DOT_FREQUENCY)) {
+void SpawnRedDot(Dot& r, Snake& s, GameTime t, Uint32& rng) {
+    if (!r.visible && (Random(rng) % 10000 <= RED_DOT_FREQUENCY)) {
         bool okPos;
         do {
             okPos = true;
-            r.x = (rand() % ((SCREEN_WIDTH / CUBE_SIZE) - 2) + 1) * CUBE_SIZE;
-            r.y = (rand() % ((GAME_HEIGHT / CUBE_SIZE) - 2) + 1) * CUBE_SIZE;
-
-            for (int i = 0; i < HISTORY_SIZE; i++) {
-                if (fabs(r.x - s.historyX[i]) < CUBE_SIZE &&
-                    fabs(r.y - s.historyY[i]) < CUBE_SIZE) {
-                    okPos = 0;
-                    break;
-                }
-            }
+            r.x = (Random(rng) % ((SCREEN_WIDTH / CUBE_SIZE) - 2) + 1) * CUBE_SIZE;
+            r.y = (Random(rng) % ((GAME_HEIGHT / CUBE_SIZE) - 2) + 1) * CUBE_SIZE;
+
+            if (HistoryOverlaps(s, r.x, r.y)) okPos = 0;
         } while (!okPos);
         r.spawnTime = t.worldTime;
         r.visible = true;
@@ -593,7 +1046,277 @@ void UpdateTime(GameTime& time, double delta) {
 }
 
 
-void GameOver(bool* quit, SDLStruct& sdl, Snake& s, Dot& b, Dot& r, GameTime& time, double* delta) {
+// one frame of the game without drawing, returns false when the game is lost
+bool StepGame(GameState& g, double delta) {
+    UpdateTime(g.time, delta);
+    SpawnRedDot(g.redDot, g.snake, g.time, g.rng);
+    MoveSnake(g.snake, g.time, delta);
+    if (GameLost(g.snake)) return false;
+    BlueDotCollision(g.snake, g.blueDot, g.rng);
+    RedDotCollision(g.snake, g.redDot, g.time, g.rng);
+    return true;
+}
+
+// Forks share the full history chunks, so a fork is a plain copy. It stays valid only until its arena
+// is compacted or released below it, ValidHistory tells. The live game compacts its arena while it
+// plays, so search bots start from ForkGameInto with an arena of their own, one per thread.
+GameState ForkGame(GameState& g) {
+    return g;
+}
+
+GameState ForkGameInto(GameState& g, HistoryArena& arena) {
+    GameState fork = g;
+    CopyHistory(fork.snake, arena);
+    return fork;
+}
+
+
+bool WriteDot(FILE* file, Dot& d) {
+    Uint8 visible = d.visible ? 1 : 0;
+    return fwrite(&d.x, sizeof(d.x), 1, file) == 1
+        && fwrite(&d.y, sizeof(d.y), 1, file) == 1
+        && fwrite(&d.color, sizeof(d.color), 1, file) == 1
+        && fwrite(&d.spawnTime, sizeof(d.spawnTime), 1, file) == 1
+        && fwrite(&d.duration, sizeof(d.duration), 1, file) == 1
+        && fwrite(&visible, sizeof(visible), 1, file) == 1;
+}
+
+bool ReadDot(FILE* file, Dot& d) {
+    Uint8 visible = 0;
+    bool ok = fread(&d.x, sizeof(d.x), 1, file) == 1
+        && fread(&d.y, sizeof(d.y), 1, file) == 1
+        && fread(&d.color, sizeof(d.color), 1, file) == 1
+        && fread(&d.spawnTime, sizeof(d.spawnTime), 1, file) == 1
+        && fread(&d.duration, sizeof(d.duration), 1, file) == 1
+        && fread(&visible, sizeof(visible), 1, file) == 1
+        && visible <= 1; //any other byte is not a bool
+    d.visible = visible == 1;
+    return ok;
+}
+
+bool SameDot(Dot& d, Dot& e) {
+    return d.x == e.x && d.y == e.y && d.color == e.color && d.spawnTime == e.spawnTime
+        && d.duration == e.duration && d.visible == e.visible;
+}
+
+bool WriteTime(FILE* file, GameTime& t) {
+    return fwrite(&t.frames, sizeof(t.frames), 1, file) == 1
+        && fwrite(&t.fpsTimer, sizeof(t.fpsTimer), 1, file) == 1
+        && fwrite(&t.fps, sizeof(t.fps), 1, file) == 1
+        && fwrite(&t.worldTime, sizeof(t.worldTime), 1, file) == 1
+        && fwrite(&t.snakeTime, sizeof(t.snakeTime), 1, file) == 1
+        && fwrite(&t.snakeLimitTime, sizeof(t.snakeLimitTime), 1, file) == 1
+        && fwrite(&t.lastHistoryUpdate, sizeof(t.lastHistoryUpdate), 1, file) == 1;
+}
+
+bool ReadTime(FILE* file, GameTime& t) {
+    return fread(&t.frames, sizeof(t.frames), 1, file) == 1
+        && fread(&t.fpsTimer, sizeof(t.fpsTimer), 1, file) == 1
+        && fread(&t.fps, sizeof(t.fps), 1, file) == 1
+        && fread(&t.worldTime, sizeof(t.worldTime), 1, file) == 1
+        && fread(&t.snakeTime, sizeof(t.snakeTime), 1, file) == 1
+        && fread(&t.snakeLimitTime, sizeof(t.snakeLimitTime), 1, file) == 1
+        && fread(&t.lastHistoryUpdate, sizeof(t.lastHistoryUpdate), 1, file) == 1;
+}
+
+bool SameTime(GameTime& p, GameTime& q) {
+    return p.frames == q.frames && p.fpsTimer == q.fpsTimer && p.fps == q.fps && p.worldTime == q.worldTime
+        && p.snakeTime == q.snakeTime && p.snakeLimitTime == q.snakeLimitTime && p.lastHistoryUpdate == q.lastHistoryUpdate;
+}
+
+
+bool ValidDot(Dot& d) {
+    return d.x >= 0 && d.x <= SCREEN_WIDTH && d.y >= 0 && d.y <= SCREEN_HEIGHT
+        && isfinite(d.spawnTime) && isfinite(d.duration) && d.duration >= 0;
+}
+
+// rejects loaded values the game can not handle, e.g. a length out of the body arrays
+bool ValidGameState(GameState& g, double* history) {
+    Snake& s = g.snake;
+    GameTime& t = g.time;
+    if (s.length < SNAKE_LENGTH || s.length > MAX_SNAKE_LENGTH) return false;
+    if (s.velocityX < -1 || s.velocityX > 1 || s.velocityY < -1 || s.velocityY > 1) return false;
+    if (!isfinite(s.speed) || s.eaten < 0 || g.rng == 0) return false;
+    for (int i = 0; i < MAX_SNAKE_LENGTH; i++) {
+        if (!isfinite(s.bodyX[i]) || !isfinite(s.bodyY[i])) return false;
+    }
+    for (int i = 0; i < 2 * HISTORY_SIZE; i++) {
+        if (!isfinite(history[i])) return false;
+    }
+    return ValidDot(g.blueDot) && ValidDot(g.redDot) && t.frames >= 0
+        && isfinite(t.fpsTimer) && isfinite(t.fps) && isfinite(t.worldTime)
+        && isfinite(t.snakeTime) && isfinite(t.snakeLimitTime) && isfinite(t.lastHistoryUpdate);
+}
+
+
+bool SaveGameState(GameState& g, const char* fileName) {
+    Snake& s = g.snake;
+    if (!ValidHistory(s)) return 1;
+    double* history = (double*)malloc(2 * HISTORY_SIZE * sizeof(double));
+    if (history == NULL) return 1;
+    for (int i = 0; i < HISTORY_SIZE; i++) {
+        GetHistory(s, i, history[2 * i], history[2 * i + 1]);
+    }
+
+    FILE* file = fopen(fileName, "wb");
+    if (file == NULL) {
+        free(history);
+        return 1;
+    }
+    Uint32 magic = CHECKPOINT_MAGIC;
+    bool ok = fwrite(&magic, sizeof(magic), 1, file) == 1
+        && fwrite(s.bodyX, sizeof(s.bodyX), 1, file) == 1
+        && fwrite(s.bodyY, sizeof(s.bodyY), 1, file) == 1
+        && fwrite(history, 2 * HISTORY_SIZE * sizeof(double), 1, file) == 1
+        && fwrite(&s.length, sizeof(s.length), 1, file) == 1
+        && fwrite(&s.speed, sizeof(s.speed), 1, file) == 1
+        && fwrite(&s.velocityX, sizeof(s.velocityX), 1, file) == 1
+        && fwrite(&s.velocityY, sizeof(s.velocityY), 1, file) == 1
+        && fwrite(&s.eaten, sizeof(s.eaten), 1, file) == 1
+        && WriteDot(file, g.blueDot)
+        && WriteDot(file, g.redDot)
+        && WriteTime(file, g.time)
+        && fwrite(&g.rng, sizeof(g.rng), 1, file) == 1;
+    ok = (fclose(file) == 0) && ok;
+    free(history);
+    return !ok;
+}
+
+
+// g is changed only if the whole checkpoint is read and valid
+bool LoadGameState(GameState& g, HistoryArena& arena, const char* fileName) {
+    GameState loaded;
+    Snake& s = loaded.snake;
+    double* history = (double*)malloc(2 * HISTORY_SIZE * sizeof(double));
+    if (history == NULL) return 1;
+
+    FILE* file = fopen(fileName, "rb");
+    if (file == NULL) {
+        free(history);
+        return 1;
+    }
+    Uint32 magic = 0;
+    bool ok = fread(&magic, sizeof(magic), 1, file) == 1 && magic == CHECKPOINT_MAGIC
+        && fread(s.bodyX, sizeof(s.bodyX), 1, file) == 1
+        && fread(s.bodyY, sizeof(s.bodyY), 1, file) == 1
+        && fread(history, 2 * HISTORY_SIZE * sizeof(double), 1, file) == 1
+        && fread(&s.length, sizeof(s.length), 1, file) == 1
+        && fread(&s.speed, sizeof(s.speed), 1, file) == 1
+        && fread(&s.velocityX, sizeof(s.velocityX), 1, file) == 1
+        && fread(&s.velocityY, sizeof(s.velocityY), 1, file) == 1
+        && fread(&s.eaten, sizeof(s.eaten), 1, file) == 1
+        && ReadDot(file, loaded.blueDot)
+        && ReadDot(file, loaded.redDot)
+        && ReadTime(file, loaded.time)
+        && fread(&loaded.rng, sizeof(loaded.rng), 1, file) == 1;
+    fclose(file);
+    if (!ok || !ValidGameState(loaded, history)) {
+        free(history);
+        return 1;
+    }
+
+    //oldest entry first, so the history ends up in the saved order
+    ResetHistory(s, arena, history[2 * (HISTORY_SIZE - 1)], history[2 * (HISTORY_SIZE - 1) + 1]);
+    for (int i = HISTORY_SIZE - 1; i >= 0; i--) {
+        PushHistory(s, history[2 * i], history[2 * i + 1]);
+    }
+    free(history);
+    g = loaded;
+    return 0;
+}
+
+
+bool SameGameState(GameState& a, GameState& b) {
+    Snake& s = a.snake;
+    Snake& t = b.snake;
+    if (s.length != t.length || s.speed != t.speed || s.velocityX != t.velocityX || s.velocityY != t.velocityY || s.eaten != t.eaten || a.rng != b.rng) return false;
+    if (memcmp(s.bodyX, t.bodyX, sizeof(s.bodyX)) != 0 || memcmp(s.bodyY, t.bodyY, sizeof(s.bodyY)) != 0) return false;
+    for (int i = 0; i < HISTORY_SIZE; i++) {
+        double x1, y1, x2, y2;
+        GetHistory(s, i, x1, y1);
+        GetHistory(t, i, x2, y2);
+        if (x1 != x2 || y1 != y2) return false;
+    }
+    return SameDot(a.blueDot, b.blueDot) && SameDot(a.redDot, b.redDot) && SameTime(a.time, b.time);
+}
+
+
+int BenchmarkForks() {
+    static GameState forks[BENCHMARK_BATCH];
+    SDL_PixelFormat* format = SDL_AllocFormat(SDL_PIXELFORMAT_ARGB8888);
+    HistoryArena arena = { NULL, 0, 0, 0 };
+    GameState root = {};
+    bool quit;
+    root.rng = RANDOM_SEED;
+    InitGame(&quit, root, arena, format);
+
+    //play a while, so the history is not a single shared chunk
+    TurnSnake(root.snake, 1, 0);
+    for (int i = 0; i < HISTORY_SIZE && StepGame(root, BENCHMARK_DELTA); i++) {
+        if (i % 50 == 0 && root.snake.velocityY == 0) TurnSnake(root.snake, 0, 1);
+        else if (i % 50 == 0) TurnSnake(root.snake, 1, 0);
+    }
+
+    //the search runs in its own arena, so compacting the game arena can not break its forks
+    HistoryArena searchArena = { NULL, 0, 0, 0 };
+    GameState search = ForkGameInto(root, searchArena);
+
+    double frequency = (double)SDL_GetPerformanceFrequency();
+    Uint64 start = SDL_GetPerformanceCounter();
+    for (int i = 0; i < BENCHMARK_FORKS; i++) {
+        forks[i % BENCHMARK_BATCH] = ForkGame(search);
+    }
+    double forkTime = (SDL_GetPerformanceCounter() - start) / frequency;
+
+    //every BENCHMARK_BATCH rollouts are one decision, their history is released after it
+    int turns[4][2] = { { -1, 0 }, { 1, 0 }, { 0, -1 }, { 0, 1 } };
+    Uint32 botRng = RANDOM_SEED;
+    int steps = 0;
+    int eaten = 0;
+    int mark = MarkHistory(searchArena);
+    int peakChunks = searchArena.count;
+    start = SDL_GetPerformanceCounter();
+    for (int i = 0; i < BENCHMARK_ROLLOUTS; i++) {
+        GameState& fork = forks[i % BENCHMARK_BATCH];
+        fork = ForkGame(search);
+        for (int j = 0; j < BENCHMARK_ROLLOUT_STEPS; j++) {
+            int turn = Random(botRng) % 4;
+            TurnSnake(fork.snake, turns[turn][0], turns[turn][1]);
+            steps++;
+            if (!StepGame(fork, BENCHMARK_DELTA)) break;
+        }
+        eaten += fork.snake.eaten;
+        if (i % BENCHMARK_BATCH == BENCHMARK_BATCH - 1) {
+            if (searchArena.count > peakChunks) peakChunks = searchArena.count;
+            ReleaseHistory(searchArena, mark);
+        }
+    }
+    double rolloutTime = (SDL_GetPerformanceCounter() - start) / frequency;
+
+    start = SDL_GetPerformanceCounter();
+    GameState loaded = root;
+    bool checkpointOk = !SaveGameState(root, BENCHMARK_CHECKPOINT_FILE)
+        && !LoadGameState(loaded, arena, BENCHMARK_CHECKPOINT_FILE)
+        && SameGameState(root, loaded);
+    double checkpointTime = (SDL_GetPerformanceCounter() - start) / frequency;
+    remove(BENCHMARK_CHECKPOINT_FILE);
+    bool searchOk = ValidHistory(search.snake);
+
+    printf("GameState size: %d bytes, history arena: %d chunks at most\n", (int)sizeof(GameState), peakChunks);
+    printf("Forks: %.0lf per second\n", BENCHMARK_FORKS / forkTime);
+    printf("Forks with %d step rollout: %.0lf per second (%.0lf steps per second, %d points)\n", BENCHMARK_ROLLOUT_STEPS, BENCHMARK_ROLLOUTS / rolloutTime, steps / rolloutTime, eaten);
+    printf("Checkpoint save and load: %s, %.3lf ms\n", checkpointOk ? "ok" : "FAILED", checkpointTime * 1000);
+    printf("Search history after release: %s\n", searchOk ? "ok" : "FAILED");
+
+    FreeHistoryArena(searchArena);
+    FreeHistoryArena(arena);
+    SDL_FreeFormat(format);
+    return checkpointOk && searchOk ? 0 : 1;
+}
+
+
+void GameOver(bool* quit, SDLStruct& sdl, GameState& g, HistoryArena& arena, double* delta) {
+    Snake& s = g.snake;
     char bestNames[NUM_BEST_SCORES][MAX_NAME_LENGTH] = { "" };
     int bestScores[NUM_BEST_SCORES] = { 0 };
     char playerName[MAX_NAME_LENGTH] = { "" };
@@ -638,13 +1361,14 @@ void GameOver(bool* quit, SDLStruct& sdl, Snake& s, Dot& b, Dot& r, GameTime& ti
                     gameOver = false;
                     CleanSDL(sdl);
                     InitSDL(sdl);
-                    InitGame(quit, s, b, r, sdl);
+                    FreeHistoryArena(arena);
+                    InitGame(quit, g, arena, sdl.screen->format);
                     int t1 = SDL_GetTicks();
                     int t2 = SDL_GetTicks();
                     *delta = (t2 - t1) * 0.001;
                     t1 = t2;
-                    UpdateTime(time, *delta);
-                    UpdateHistory(s, time);
+                    UpdateTime(g.time, *delta);
+                    UpdateHistory(s, g.time);
                 }
             }
         }
@@ -652,15 +1376,112 @@ void GameOver(bool* quit, SDLStruct& sdl, Snake& s, Dot& b, Dot& r, GameTime& ti
 }
 
 
+// draws a large screen tiled with game frames, first directly with one thread as the reference,
+// then banded with 2, 4... threads up to the CPU count, and compares every result with the reference
+int BenchmarkRender() {
+    SDLStruct sdl = {};
+    sdl.screen = SDL_CreateRGBSurface(0, BENCHMARK_RENDER_WIDTH, BENCHMARK_RENDER_HEIGHT, 32, 0x00FF0000, 0x0000FF00, 0x000000FF, 0xFF000000);
+    sdl.charset = SDL_LoadBMP("./cs8x8.bmp");
+    sdl.body = SDL_LoadBMP("./body.bmp");
+    sdl.body2 = SDL_LoadBMP("./body2.bmp");
+    sdl.head = SDL_LoadBMP("./head.bmp");
+    sdl.tail = SDL_LoadBMP("./tail.bmp");
+    if (sdl.screen == NULL || sdl.charset == NULL || sdl.body == NULL || sdl.head == NULL || sdl.tail == NULL || sdl.body2 == NULL) {
+        printf("BenchmarkRender error: %s\n", SDL_GetError());
+        SDL_FreeSurface(sdl.screen);
+        SDL_FreeSurface(sdl.charset);
+        SDL_FreeSurface(sdl.body);
+        SDL_FreeSurface(sdl.body2);
+        SDL_FreeSurface(sdl.head);
+        SDL_FreeSurface(sdl.tail);
+        return 1;
+    }
+    SDL_SetColorKey(sdl.charset, true, 0x000000);
+
+    //a long snake and both dots, so every tile has sprites, circles, rectangles and text
+    HistoryArena arena = { NULL, 0, 0, 0 };
+    GameState game = {};
+    bool quit;
+    game.rng = RANDOM_SEED;
+    InitGame(&quit, game, arena, sdl.screen->format);
+    game.snake.length = MAX_SNAKE_LENGTH;
+    TurnSnake(game.snake, 1, 0);
+    for (int i = 0; i < 90; i++) StepGame(game, BENCHMARK_DELTA);
+    game.redDot.x = SCREEN_WIDTH / 4;
+    game.redDot.y = GAME_HEIGHT / 4;
+    game.redDot.spawnTime = game.time.worldTime - game.redDot.duration / 2;
+    game.redDot.visible = true;
+
+    int size = sdl.screen->pitch * sdl.screen->h;
+    Uint8* reference = (Uint8*)malloc(size);
+    int cpus = SDL_GetCPUCount();
+    if (cpus < 2) cpus = 2; //compare at least one banded run with the reference
+    if (cpus > MAX_RENDER_THREADS) cpus = MAX_RENDER_THREADS;
+    double serialTime = 0;
+    int result = 0;
+    if (reference == NULL) {
+        printf("BenchmarkRender error: out of memory\n");
+        result = 1;
+    }
+    for (int threads = 1; result == 0; threads = (threads * 2 > cpus) ? cpus : threads * 2) {
+        if (InitRasterizer(sdl, threads)) {
+            printf("InitRasterizer error: %s\n", SDL_GetError());
+            FreeRasterizer(sdl);
+            result = 1;
+            break;
+        }
+        Rasterizer& raster = *sdl.raster;
+        Uint64 start = SDL_GetPerformanceCounter();
+        for (int i = 0; i < BENCHMARK_RENDER_FRAMES; i++) {
+            QueueClear(raster, SDL_MapRGB(sdl.screen->format, 0x00, 0x00, 0x00));
+            for (int oy = 0; oy < sdl.screen->h; oy += SCREEN_HEIGHT) {
+                for (int ox = 0; ox < sdl.screen->w; ox += SCREEN_WIDTH) {
+                    QueueGame(raster, sdl.screen->format, ox, oy, game.snake, game.blueDot, game.redDot, game.time);
+                }
+            }
+            FlushDrawCommands(raster);
+        }
+        double frameTime = (SDL_GetPerformanceCounter() - start) / (double)SDL_GetPerformanceFrequency() / BENCHMARK_RENDER_FRAMES;
+        FreeRasterizer(sdl);
+
+        if (threads == 1) {
+            serialTime = frameTime;
+            memcpy(reference, sdl.screen->pixels, size);
+            printf("%dx%d, direct drawing: %.3lf ms per frame\n", sdl.screen->w, sdl.screen->h, frameTime * 1000);
+        }
+        else {
+            bool identical = memcmp(reference, sdl.screen->pixels, size) == 0;
+            printf("%dx%d, %d threads: %.3lf ms per frame, %.2lfx, output %s\n", sdl.screen->w, sdl.screen->h, threads, frameTime * 1000, serialTime / frameTime, identical ? "matches" : "DIFFERS");
+            if (!identical) result = 1;
+        }
+        if (threads == cpus) break;
+    }
+
+    free(reference);
+    FreeHistoryArena(arena);
+    SDL_FreeSurface(sdl.screen);
+    SDL_FreeSurface(sdl.charset);
+    SDL_FreeSurface(sdl.body);
+    SDL_FreeSurface(sdl.body2);
+    SDL_FreeSurface(sdl.head);
+    SDL_FreeSurface(sdl.tail);
+    return result;
+}
+
+
 int main(int argc, char** argv) {
+    if (argc > 1 && strcmp(argv[1], BENCHMARK_FORKS_ARG) == 0) return BenchmarkForks();
+    if (argc > 1 && strcmp(argv[1], BENCHMARK_RENDER_ARG) == 0) return BenchmarkRender();
+
     SDLStruct sdl;
     bool quit;
-    Snake snake;
-    Dot blueDot, redDot;
-    GameTime time = { 0, 0, 0, 0, 0, 0, 0 };
+    GameState game;
+    HistoryArena arena = { NULL, 0, 0, 0 };
+    game.time = { 0, 0, 0, 0, 0, 0, 0 };
+    game.rng = RANDOM_SEED;
 
     if (InitSDL(sdl)) return 1;
-    InitGame(&quit, snake, blueDot, redDot, sdl);
+    InitGame(&quit, game, arena, sdl.screen->format);
 
     int t1 = SDL_GetTicks();
 
@@ -668,29 +1489,28 @@ int main(int argc, char** argv) {
         int t2 = SDL_GetTicks();
         double delta = (t2 - t1) * 0.001;
         t1 = t2;
-        UpdateTime(time, delta);
-        SpawnRedDot(redDot, snake, time);
 
         SDL_Event event;
         while (SDL_PollEvent(&event)) {
-            if (!UserInput(&quit, snake, event)) {
+            if (!UserInput(&quit, game.snake, event)) {
                 CleanSDL(sdl);
-                time = { 0, 0, 0, 0 };
+                game.time = { 0, 0, 0, 0 };
                 if (InitSDL(sdl)) return 1;
-                InitGame(&quit, snake, blueDot, redDot, sdl);
+                FreeHistoryArena(arena);
+                InitGame(&quit, game, arena, sdl.screen->format);
                 int t1 = SDL_GetTicks();
                 delta = (t2 - t1) * 0.001;
                 t1 = t2;
-                UpdateTime(time, delta);
-                UpdateHistory(snake, time);
+                UpdateTime(game.time, delta);
+                UpdateHistory(game.snake, game.time);
             }
         }
-        MoveSnake(snake, time, delta);
-        Draw(sdl, snake, blueDot, redDot, time);
-        if (Collision(snake) && snake.bodyX[SNAKE_LENGTH - 1] != SCREEN_WIDTH / 2) GameOver(&quit, sdl, snake, blueDot, redDot, time, &delta);
-        BlueDotCollision(snake, blueDot);
-        RedDotCollision(snake, redDot, time);
+        bool lost = !StepGame(game, delta);
+        if (arena.count > 2 * HISTORY_CHUNKS) CompactHistory(arena, game.snake);
+        Draw(sdl, game.snake, game.blueDot, game.redDot, game.time);
+        if (lost) GameOver(&quit, sdl, game, arena, &delta);
     }
     CleanSDL(sdl);
+    FreeHistoryArena(arena);
     return 0;
 }